@@ -0,0 +1,102 @@
+#pragma once
+
+#include "memory.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+typedef tracked_string<MemTag::CHECKPOINT> Snapshot;
+
+/* Builds up a compact binary snapshot in memory. Values are written in the
+native byte order, so snapshots are only meant to be read back on the same
+kind of machine. */
+struct BinaryWriter {
+    Snapshot data;
+
+    template <class T> void put(const T& value) {
+        data.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+};
+
+struct BinaryReader {
+    Snapshot data;
+    size_t pos;
+
+    explicit BinaryReader(Snapshot data) : data(std::move(data)), pos(0) {}
+
+    template <class T> T get() {
+        if (data.size() - pos < sizeof(T))
+            throw std::runtime_error("Checkpoint is truncated");
+        T out;
+        std::memcpy(&out, data.data() + pos, sizeof(T));
+        pos += sizeof(T);
+        return out;
+    }
+
+    static BinaryReader from_file(const std::string& path) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+            throw std::runtime_error("Could not open checkpoint " + path);
+        return BinaryReader(Snapshot(std::istreambuf_iterator<char>(file),
+                                     std::istreambuf_iterator<char>()));
+    }
+};
+
+/**
+ * @brief Writes files on a background thread, so the caller only pays for
+ * making a copy of the data. Each file is written next to its destination
+ * and then renamed over it, so a crash never leaves a half-written file.
+ * Failures are reported on stderr by the next wait().
+ */
+struct AsyncFileWriter {
+    std::thread worker;
+    std::string error; // Why the last write failed, set by the worker
+    size_t failures;   // Writes that failed so far
+
+    AsyncFileWriter() : failures(0) {}
+    AsyncFileWriter(const AsyncFileWriter&) = delete;
+    AsyncFileWriter& operator=(const AsyncFileWriter&) = delete;
+    ~AsyncFileWriter() { wait(); }
+
+    /* Waits for the last write to finish, returning false if it failed */
+    bool wait() {
+        if (worker.joinable())
+            worker.join();
+        if (error.empty())
+            return true;
+        std::cerr << error << std::endl;
+        error.clear();
+        ++failures;
+        return false;
+    }
+
+    void write(const std::string& path, Snapshot data) {
+        wait();
+        worker = std::thread([this, path](const Snapshot& data) {
+            std::string temp = path + ".tmp";
+            {
+                std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+                if (!file) {
+                    error = "Could not open " + temp + ": " +
+                            std::strerror(errno);
+                    return;
+                }
+                file.write(data.data(), data.size());
+                file.close();
+                if (!file) {
+                    error = "Could not write " + temp;
+                    std::remove(temp.c_str());
+                    return;
+                }
+            }
+            if (std::rename(temp.c_str(), path.c_str()) != 0)
+                error = "Could not move " + temp + " to " + path + ": " +
+                        std::strerror(errno);
+        }, std::move(data));
+    }
+};
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cmath>
+#include <cstdio>
+#include <ostream>
+
+/**
+ * @brief The number of decimal places numbers in the SVG output are rounded
+ * to. Trailing zeros are always left off.
+ */
+inline int& svg_precision() {
+    static int precision = 1;
+    return precision;
+}
+
+/**
+ * @brief Writes `value` as text without going through the locale. It is
+ * rounded to `decimals` places and trailing zeros are left off, so whole
+ * numbers have no decimal point at all.
+ *
+ * @param out Where to write. Must have room for at least 32 characters.
+ * @param value The number to write. Non-finite values are written as 0.
+ * @param decimals The number of decimal places to round to. Capped to being
+ * between 0 and 9.
+ * @return char* One past the last character written. Nothing is null
+ * terminated.
+ */
+inline char* format_number(char* out, double value, int decimals) {
+    static const unsigned long long POW10[] = {
+        1,      10,      100,      1000,      10000,
+        100000, 1000000, 10000000, 100000000, 1000000000};
+    if (decimals < 0)
+        decimals = 0;
+    else if (decimals > 9)
+        decimals = 9;
+    if (!std::isfinite(value)) {
+        *out = '0';
+        return out + 1;
+    }
+    double scaled = std::round(value * POW10[decimals]);
+    if (std::fabs(scaled) >= 9e18) {
+        // Too big for the integer path, which never happens for coordinates
+        return out + std::snprintf(out, 32, "%g", value);
+    }
+    long long n = (long long)scaled;
+    if (n < 0)
+        *out++ = '-';
+    unsigned long long u = n < 0 ? -(unsigned long long)n : n;
+    unsigned long long whole = u / POW10[decimals];
+    unsigned long long frac = u % POW10[decimals];
+    // Digits come out backwards, so fill in from the right
+    char digits[20];
+    char* d = digits + sizeof(digits);
+    do {
+        *--d = '0' + whole % 10;
+        whole /= 10;
+    } while (whole);
+    while (d != digits + sizeof(digits))
+        *out++ = *d++;
+    if (frac) {
+        while (frac % 10 == 0) {
+            frac /= 10;
+            --decimals;
+        }
+        *out++ = '.';
+        for (int i = decimals - 1; i >= 0; --i) {
+            out[i] = '0' + frac % 10;
+            frac /= 10;
+        }
+        out += decimals;
+    }
+    return out;
+}
+
+/* Streams a number using format_number and svg_precision() */
+struct FormattedNumber {
+    double value;
+
+    explicit FormattedNumber(double value) : value(value) {}
+
+    friend std::ostream& operator<<(std::ostream& a,
+                                    const FormattedNumber& b) {
+        char buffer[32];
+        return a.write(buffer, format_number(buffer, b.value, svg_precision()) -
+                                   buffer);
+    }
+};
+
+inline FormattedNumber fmt_num(double value) { return FormattedNumber(value); }
@@ -1,11 +1,41 @@
 #pragma once
 
+#include "format.h"
+#include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <condition_variable>
+#include <functional>
 #include <list>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
+
+/* SplitMix64. Its whole state is one number, so a run can be saved and picked
+up again exactly. */
+struct Random {
+    unsigned long long state;
+
+    explicit Random(unsigned long long seed = 0) : state(seed) {}
+
+    unsigned long long next() {
+        unsigned long long z = (state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+};
+
+/* Where everything random is drawn from */
+inline Random& rng() {
+    static Random random;
+    return random;
+}
 
 inline double frandrange(double min, double max) {
-    return min + fabs(fmod(rand() / 1000000.0, max - min));
+    // Top 53 bits make a double in [0, 1)
+    return min + (max - min) * (rng().next() >> 11) / 9007199254740992.0;
 }
 
 template <class T>
@@ -18,6 +48,12 @@ const T& cap_range(const T& value, const T& min, const T& max) {
         return value;
 }
 
+struct HSL {
+    double hue;
+    double saturation;
+    double light;
+};
+
 /**
  * @brief Turns values for hue, shade, and light into an SVG-usable string like
  * "hsl(10, 80%, 90%)"
@@ -33,18 +69,31 @@ inline std::string to_hsl(double hue, double saturation, double light) {
     hue = fmod(fabs(hue), 360);
     saturation = cap_range(saturation, 0.0, 100.0);
     light = cap_range(light, 0.0, 100.0);
-    return "hsl(" + std::to_string(std::round(hue * 10) / 10.0) + ", " +
-           std::to_string(std::round(saturation * 10) / 10.0) + "%, " +
-           std::to_string(std::round(light * 10) / 10.0) + "%)";
+    char buffer[128] = "hsl(";
+    char* end = format_number(buffer + 4, hue, 1);
+    *end++ = ',';
+    *end++ = ' ';
+    end = format_number(end, saturation, 1);
+    *end++ = '%';
+    *end++ = ',';
+    *end++ = ' ';
+    end = format_number(end, light, 1);
+    *end++ = '%';
+    *end++ = ')';
+    return std::string(buffer, end);
+}
+inline std::string to_hsl(const HSL& color) {
+    return to_hsl(color.hue, color.saturation, color.light);
 }
 
 inline bool in_range(double width, double height, double x, double y) {
     return 0 <= x && x < width && 0 <= y && y < height;
 }
 
-template <class T>
-typename std::list<T>::iterator loop_next(std::list<T>& loop,
-                                          typename std::list<T>::iterator itr) {
+template <class T, class Alloc>
+typename std::list<T, Alloc>::iterator
+loop_next(std::list<T, Alloc>& loop,
+          typename std::list<T, Alloc>::iterator itr) {
     ++itr;
     if (itr == loop.end())
         return loop.begin();
@@ -52,9 +101,10 @@ typename std::list<T>::iterator loop_next(std::list<T>& loop,
         return itr;
 }
 
-template <class T>
-typename std::list<T>::iterator loop_prev(std::list<T>& loop,
-                                          typename std::list<T>::iterator itr) {
+template <class T, class Alloc>
+typename std::list<T, Alloc>::iterator
+loop_prev(std::list<T, Alloc>& loop,
+          typename std::list<T, Alloc>::iterator itr) {
     if (itr == loop.begin())
         return --loop.end();
     else
@@ -63,4 +113,95 @@ typename std::list<T>::iterator loop_prev(std::list<T>& loop,
 
 inline double normalize_rad(double rad) {
     return fmod(fmod(rad, M_PI * 2) + M_PI * 2, M_PI * 2);
-}
\ No newline at end of file
+}
+
+/**
+ * @brief A fixed set of threads that loops are split between. Starting a
+ * thread costs more than a small loop does, so they are started once and
+ * then kept waiting for work.
+ */
+class WorkerPool {
+public:
+    /* Uses `threads` threads in total, counting the caller of run() */
+    explicit WorkerPool(size_t threads = std::thread::hardware_concurrency())
+        : job(nullptr), count(0), next(0), generation(0), running(0),
+          stopping(false) {
+        for (size_t t = 1; t < threads; ++t)
+            workers.emplace_back(&WorkerPool::work_loop, this);
+    }
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+    ~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        start.notify_all();
+        for (std::thread& worker : workers)
+            worker.join();
+    }
+
+    size_t size() const { return workers.size() + 1; }
+
+    /**
+     * @brief Calls `func(i)` for every i in [0, count) and waits for them all
+     * to finish. Indices are handed out one at a time, so uneven work still
+     * gets spread out.
+     *
+     * @param count The number of indices to call `func` with.
+     * @param func The function to call. Must be safe to call concurrently.
+     */
+    void run(size_t count, const std::function<void(size_t)>& func) {
+        if (workers.empty() || count < 2) {
+            for (size_t i = 0; i < count; ++i)
+                func(i);
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = &func;
+            this->count = count;
+            next = 0;
+            running = workers.size();
+            ++generation;
+        }
+        start.notify_all();
+        work();
+        std::unique_lock<std::mutex> lock(mutex);
+        finish.wait(lock, [this]() { return running == 0; });
+        job = nullptr;
+    }
+
+private:
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable start;
+    std::condition_variable finish;
+    // The current loop. Only changed while no worker is running it.
+    const std::function<void(size_t)>* job;
+    size_t count;
+    std::atomic<size_t> next;
+    size_t generation; // Goes up by one for each loop
+    size_t running;    // Workers that haven't finished the current loop
+    bool stopping;
+
+    void work() {
+        for (size_t i = next++; i < count; i = next++)
+            (*job)(i);
+    }
+    void work_loop() {
+        size_t seen = 0;
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            start.wait(lock, [&]() { return stopping || generation != seen; });
+            if (stopping)
+                return;
+            seen = generation;
+            lock.unlock();
+            work();
+            lock.lock();
+            if (--running == 0)
+                finish.notify_one();
+        }
+    }
+};
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <atomic>
+#include <list>
+#include <map>
+#include <new>
+#include <ostream>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/* What an allocation is for, to see where the memory goes */
+enum class MemTag {
+    POINTS,
+    LINKS,
+    GRID,
+    FRONTIER,
+    TRIANGLES,
+    SVG,
+    STRINGS,
+    CHECKPOINT,
+    COUNT,
+};
+
+inline const char* mem_tag_name(MemTag tag) {
+    static const char* names[] = {"points", "links",   "grid",
+                                  "frontier", "triangles", "svg",
+                                  "strings", "checkpoint"};
+    return names[(size_t)tag];
+}
+
+/* Live and peak bytes for one MemTag. Updated from any thread. */
+struct MemCounter {
+    std::atomic<size_t> live;
+    std::atomic<size_t> peak;
+
+    MemCounter() : live(0), peak(0) {}
+
+    void add(size_t bytes) {
+        size_t now = live.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+        size_t old = peak.load(std::memory_order_relaxed);
+        while (now > old &&
+               !peak.compare_exchange_weak(old, now, std::memory_order_relaxed))
+            ;
+    }
+    void remove(size_t bytes) {
+        live.fetch_sub(bytes, std::memory_order_relaxed);
+    }
+};
+
+/**
+ * @brief The counters for every MemTag, followed by one for the total.
+ */
+inline MemCounter* mem_counters() {
+    static MemCounter counters[(size_t)MemTag::COUNT + 1];
+    return counters;
+}
+
+/**
+ * @brief Whether allocations are being counted. Off by default, since the
+ * counters are shared between threads. Must only be turned on before anything
+ * tracked is allocated, or later frees would be counted without their
+ * allocations.
+ */
+inline bool& mem_tracking() {
+    static bool tracking = false;
+    return tracking;
+}
+
+inline void mem_alloc(MemTag tag, size_t bytes) {
+    if (!mem_tracking())
+        return;
+    mem_counters()[(size_t)tag].add(bytes);
+    mem_counters()[(size_t)MemTag::COUNT].add(bytes);
+}
+inline void mem_free(MemTag tag, size_t bytes) {
+    if (!mem_tracking())
+        return;
+    mem_counters()[(size_t)tag].remove(bytes);
+    mem_counters()[(size_t)MemTag::COUNT].remove(bytes);
+}
+
+/* Prints the live and peak bytes of every MemTag */
+inline std::ostream& print_mem_stats(std::ostream& a) {
+    a << "memory (live / peak MB):";
+    for (size_t i = 0; i <= (size_t)MemTag::COUNT; ++i) {
+        const MemCounter& counter = mem_counters()[i];
+        a << "\n  "
+          << (i == (size_t)MemTag::COUNT ? "total" : mem_tag_name((MemTag)i))
+          << ": " << counter.live / 1e6 << " / " << counter.peak / 1e6;
+    }
+    return a;
+}
+
+/* A std::allocator that counts its memory towards `Tag` */
+template <class T, MemTag Tag> struct TrackedAllocator {
+    typedef T value_type;
+
+    template <class U> struct rebind {
+        typedef TrackedAllocator<U, Tag> other;
+    };
+
+    TrackedAllocator() = default;
+    template <class U>
+    TrackedAllocator(const TrackedAllocator<U, Tag>&) {}
+
+    T* allocate(size_t n) {
+        mem_alloc(Tag, n * sizeof(T));
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+    void deallocate(T* p, size_t n) {
+        mem_free(Tag, n * sizeof(T));
+        ::operator delete(p);
+    }
+
+    template <class U>
+    bool operator==(const TrackedAllocator<U, Tag>&) const {
+        return true;
+    }
+    template <class U>
+    bool operator!=(const TrackedAllocator<U, Tag>&) const {
+        return false;
+    }
+};
+
+template <class T, MemTag Tag>
+using tracked_list = std::list<T, TrackedAllocator<T, Tag>>;
+template <class T, MemTag Tag>
+using tracked_vector = std::vector<T, TrackedAllocator<T, Tag>>;
+template <class K, class V, MemTag Tag, class Compare = std::less<K>>
+using tracked_map =
+    std::map<K, V, Compare, TrackedAllocator<std::pair<const K, V>, Tag>>;
+template <class K, MemTag Tag, class Compare = std::less<K>>
+using tracked_set = std::set<K, Compare, TrackedAllocator<K, Tag>>;
+template <class K, class V, MemTag Tag, class Hash = std::hash<K>>
+using tracked_unordered_map =
+    std::unordered_map<K, V, Hash, std::equal_to<K>,
+                       TrackedAllocator<std::pair<const K, V>, Tag>>;
+template <MemTag Tag>
+using tracked_string =
+    std::basic_string<char, std::char_traits<char>,
+                      TrackedAllocator<char, Tag>>;
+
+// GCC 12 inlines Tracked::operator new into new-expressions, then sees the
+// ::operator new inside it paired with Tracked::operator delete on the
+// cleanup path and warns with -Wmismatched-new-delete. Keeping it out of line
+// hides the pairing, and costs a call per tracked object.
+#if defined(__GNUC__)
+#define MEM_NOINLINE __attribute__((noinline))
+#else
+#define MEM_NOINLINE
+#endif
+
+/* Inherit from this to count `new`ed objects towards `Tag`. The size given
+to delete is that of the actual type as long as the destructor is virtual
+or the object is deleted as its own type. */
+template <MemTag Tag> struct Tracked {
+    MEM_NOINLINE static void* operator new(size_t size) {
+        mem_alloc(Tag, size);
+        return ::operator new(size);
+    }
+    static void operator delete(void* p, size_t size) {
+        mem_free(Tag, size);
+        ::operator delete(p);
+    }
+};
@@ -2,8 +2,8 @@
 // Based on implementation in
 // https://en.wikipedia.org/wiki/Perlin_noise#Implementation
 
+#include "lib.h"
 #include <cmath>
-#include <ctime>
 #include <random>
 
 struct PerlinGen {
@@ -11,7 +11,7 @@ struct PerlinGen {
     unsigned rand_a, rand_b, rand_c;
 
     PerlinGen()
-        : engine(time(NULL)), rand_a(engine()), rand_b(engine()),
+        : engine(rng().next()), rand_a(engine()), rand_b(engine()),
           rand_c(engine()) {}
 
     /* Function to linearly interpolate between a0 and a1
@@ -101,19 +101,108 @@ struct PerlinGen {
     }
 };
 
+/* One octave of noise, sampled at (x, y) * Num / Den and multiplied by
+ * Weight. Scales are ratios since template parameters can't be doubles.
+ */
+template <int Num, int Den, int Weight> struct Octave {
+    static constexpr double scale = (double)Num / Den;
+    static constexpr double weight = Weight;
+};
+
+/* Base plus the sum of some Octaves, all drawn from the same noise
+ */
+template <int Base, class... Octaves> struct Channel {
+    static double eval(const PerlinGen& gen, double x, double y) {
+        double sum = Base;
+        // Expands to one term per octave, all inlined with constant scales
+        int expand[] = {0, (sum += gen.perlin(x * Octaves::scale,
+                                              y * Octaves::scale) *
+                                   Octaves::weight,
+                            0)...};
+        (void)expand;
+        return sum;
+    }
+};
+
+/* A full color function made of a Channel for each of hue, saturation, and
+ * light. Each instantiation compiles down to its own fused function.
+ */
+template <class Hue, class Saturation, class Light> struct Palette {
+    static HSL eval(const PerlinGen& hueGen, const PerlinGen& satGen,
+                    const PerlinGen& lightGen, double x, double y) {
+        return {fmod(fabs(Hue::eval(hueGen, x, y)), 360.0),
+                Saturation::eval(satGen, x, y), Light::eval(lightGen, x, y)};
+    }
+};
+
+typedef HSL (*PaletteFn)(const PerlinGen&, const PerlinGen&, const PerlinGen&,
+                         double, double);
+struct PaletteEntry {
+    const char* name;
+    PaletteFn eval;
+};
+
+// clang-format off
+typedef Palette<Channel<360, Octave<1, 8, 720>, Octave<1, 1, 90>>,
+                Channel<60, Octave<1, 2, 10>, Octave<1, 1, 10>, Octave<4, 1, 20>>,
+                Channel<50, Octave<1, 4, 10>, Octave<1, 1, 10>, Octave<4, 1, 5>>>
+    ClassicPalette;
+typedef Palette<Channel<200, Octave<1, 8, 40>, Octave<1, 1, 15>>,
+                Channel<65, Octave<1, 2, 15>, Octave<2, 1, 10>>,
+                Channel<45, Octave<1, 4, 12>, Octave<1, 1, 8>, Octave<4, 1, 4>>>
+    OceanPalette;
+typedef Palette<Channel<15, Octave<1, 8, 30>, Octave<1, 1, 12>>,
+                Channel<80, Octave<1, 2, 10>, Octave<4, 1, 10>>,
+                Channel<45, Octave<1, 4, 15>, Octave<1, 1, 10>>>
+    EmberPalette;
+typedef Palette<Channel<110, Octave<1, 8, 50>, Octave<1, 1, 15>>,
+                Channel<45, Octave<1, 2, 15>, Octave<1, 1, 10>>,
+                Channel<38, Octave<1, 4, 12>, Octave<4, 1, 6>>>
+    ForestPalette;
+typedef Palette<Channel<360, Octave<1, 8, 720>, Octave<1, 1, 60>>,
+                Channel<45, Octave<1, 2, 10>, Octave<1, 1, 5>>,
+                Channel<80, Octave<1, 4, 5>, Octave<1, 1, 5>>>
+    PastelPalette;
+// clang-format on
+
+static const PaletteEntry PALETTES[] = {
+    {"classic", &ClassicPalette::eval}, {"ocean", &OceanPalette::eval},
+    {"ember", &EmberPalette::eval},     {"forest", &ForestPalette::eval},
+    {"pastel", &PastelPalette::eval},
+};
+
+/**
+ * @brief The palette new ColorMaps use. Defaults to "classic".
+ */
+inline const PaletteEntry*& palette_choice() {
+    static const PaletteEntry* choice = &PALETTES[0];
+    return choice;
+}
+
+/**
+ * @brief Looks up a palette from PALETTES by name.
+ *
+ * @return const PaletteEntry* The palette, or nullptr if there is none by
+ * that name.
+ */
+inline const PaletteEntry* find_palette(const std::string& name) {
+    for (const PaletteEntry& palette : PALETTES) {
+        if (name == palette.name)
+            return &palette;
+    }
+    return nullptr;
+}
+
 struct ColorMap {
     PerlinGen colorGen, satGen, lightGen;
+    PaletteFn palette;
 
+    ColorMap() : palette(palette_choice()->eval) {}
+
+    HSL hsl(double x, double y) const {
+        return palette(colorGen, satGen, lightGen, x, y);
+    }
     std::string operator()(double x, double y) const {
-        double color = colorGen.perlin(x / 8, y / 8) * 720 + 360 +
-                       colorGen.perlin(x, y) * 90;
-        color = fmod(fabs(color), 360.0);
-        double saturation = satGen.perlin(x / 2, y / 2) * 10 +
-                            satGen.perlin(x, y) * 10 +
-                            satGen.perlin(x * 4, y * 4) * 20 + 60;
-        double light = lightGen.perlin(x / 4, y / 4) * 10 +
-                       lightGen.perlin(x, y) * 10 +
-                       lightGen.perlin(x * 4, y * 4) * 5 + 50;
-        return to_hsl(color, saturation, light);
+        return to_hsl(hsl(x, y));
     }
 };
\ No newline at end of file
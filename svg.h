@@ -1,12 +1,23 @@
 #pragma once
 
+#include "format.h"
+#include "memory.h"
+#include <algorithm>
+#include <cmath>
 #include <fstream>
 #include <iostream>
 #include <list>
 #include <set>
 #include <utility>
 
-struct SVG_Tag {
+// Strings held by SVG objects, counted towards MemTag::STRINGS
+typedef tracked_string<MemTag::STRINGS> SVG_String;
+
+inline SVG_String svg_string(const std::string& str) {
+    return SVG_String(str.data(), str.size());
+}
+
+struct SVG_Tag : Tracked<MemTag::SVG> {
     virtual ~SVG_Tag() = default;
 
     virtual std::ostream& print(std::ostream& ostr) const = 0;
@@ -23,15 +34,16 @@ struct SVG_Line : SVG_Shape {
     double y1;
     double x2;
     double y2;
-    std::string color;
+    SVG_String color;
     int width;
 
     SVG_Line(double x1, double y1, double x2, double y2)
         : x1(x1), y1(y1), x2(x2), y2(y2), width(-1) {}
 
     std::ostream& print(std::ostream& a) const override {
-        a << "<line x1=\"" << x1 << "\" y1=\"" << y1 << "\" x2=\"" << x2
-          << "\" y2=\"" << y2 << "\" style=\"";
+        a << "<line x1=\"" << fmt_num(x1) << "\" y1=\"" << fmt_num(y1)
+          << "\" x2=\"" << fmt_num(x2) << "\" y2=\"" << fmt_num(y2)
+          << "\" style=\"";
         if (!color.empty())
             a << "stroke:" << color << ";";
         if (width >= 0)
@@ -41,13 +53,19 @@ struct SVG_Line : SVG_Shape {
 };
 
 struct SVG_Polygon : SVG_Shape {
-    std::list<std::pair<long long, long long>> points;
-    std::string color;
+    tracked_list<std::pair<double, double>, MemTag::SVG> points;
+    SVG_String color;
 
     std::ostream& print(std::ostream& a) const override {
         a << "<polygon points=\"";
-        for (const std::pair<long long, long long>& p : points)
-            a << p.first << ',' << p.second << ' ';
+        char buffer[66];
+        for (const std::pair<double, double>& p : points) {
+            char* end = format_number(buffer, p.first, svg_precision());
+            *end++ = ',';
+            end = format_number(end, p.second, svg_precision());
+            *end++ = ' ';
+            a.write(buffer, end - buffer);
+        }
         a << "\" style=\"";
         if (!color.empty())
             a << "fill:" << color << ";";
@@ -55,14 +73,92 @@ struct SVG_Polygon : SVG_Shape {
     }
 };
 
+/* A path drawn with relative commands, keeping the `d` attribute as short as
+possible. Coordinates are tracked after rounding to svg_precision(), so
+rounding errors don't build up along the path. */
+struct SVG_Path : SVG_Shape {
+    SVG_String d;
+    SVG_String color;
+
+    explicit SVG_Path(const std::string& color = "")
+        : color(svg_string(color)), decimals(svg_precision()),
+          scale(std::pow(10.0, decimals)), x(0), y(0), start_x(0), start_y(0),
+          command(0), last_dot(false) {}
+
+    void move_to(double to_x, double to_y) {
+        add_command('m', to_x, to_y);
+        start_x = x;
+        start_y = y;
+        // Any more coordinates straight after a move are line-tos
+        command = 'l';
+    }
+    void line_to(double to_x, double to_y) { add_command('l', to_x, to_y); }
+    /* Closes the current subpath. Drawing can continue from where it
+    started without another move. */
+    void close() {
+        d += 'z';
+        command = 'z';
+        x = start_x;
+        y = start_y;
+    }
+
+    std::ostream& print(std::ostream& a) const override {
+        a << "<path d=\"" << d << "\" style=\"";
+        if (!color.empty())
+            a << "fill:" << color << ";";
+        return a << "\" />";
+    }
+
+private:
+    int decimals;
+    double scale;
+    // In units of 10^-decimals
+    long long x, y, start_x, start_y;
+    char command;
+    bool last_dot; // The last number written had a decimal point
+
+    void add_command(char c, double to_x, double to_y) {
+        long long new_x = std::llround(to_x * scale);
+        long long new_y = std::llround(to_y * scale);
+        bool separate = command == c;
+        if (!separate) {
+            d += c;
+            command = c;
+        }
+        add_number(new_x - x, separate);
+        add_number(new_y - y, true);
+        x = new_x;
+        y = new_y;
+    }
+    void add_number(long long units, bool separate) {
+        char buffer[32];
+        char* begin = buffer;
+        char* end = format_number(buffer, units / scale, decimals);
+        // Leading zeros aren't needed: "0.5" is ".5" and "-0.5" is "-.5"
+        bool negative = *begin == '-';
+        if (end - begin > 2 + negative && begin[negative] == '0' &&
+            begin[negative + 1] == '.') {
+            if (negative)
+                begin[1] = '-';
+            ++begin;
+        }
+        bool dot = std::find(begin, end, '.') != end;
+        // A space is only needed if the number couldn't be told apart
+        if (separate && *begin != '-' && !(*begin == '.' && last_dot))
+            d += ' ';
+        d.append(begin, end);
+        last_dot = dot;
+    }
+};
+
 struct SVG_Circle : SVG_Shape {
     double cx;
     double cy;
     double radius;
-    std::string stroke;
+    SVG_String stroke;
     int stroke_width;
     double stroke_opacity;
-    std::string fill;
+    SVG_String fill;
     double fill_opacity;
 
     SVG_Circle()
@@ -73,32 +169,33 @@ struct SVG_Circle : SVG_Shape {
           fill_opacity(1) {}
 
     std::ostream& print(std::ostream& a) const override {
-        a << "<circle cx=\"" << cx << "\" cy=\"" << cy << "\" r=\"" << radius
-          << "\" ";
+        a << "<circle cx=\"" << fmt_num(cx) << "\" cy=\"" << fmt_num(cy)
+          << "\" r=\"" << fmt_num(radius) << "\" ";
         if (!stroke.empty())
             a << "stroke=\"" << stroke << "\" ";
         if (stroke_width >= 0)
             a << "stroke-width=\"" << stroke_width << "\" ";
         if (stroke_opacity < 1)
-            a << "stroke-opacity=\"" << stroke_opacity << "\" ";
+            a << "stroke-opacity=\"" << fmt_num(stroke_opacity) << "\" ";
         if (!fill.empty())
             a << "fill=\"" << fill << "\" ";
         if (fill_opacity < 1)
-            a << "fill-opacity=\"" << fill_opacity << "\" ";
+            a << "fill-opacity=\"" << fmt_num(fill_opacity) << "\" ";
         return a << "/>";
     }
 };
 struct SVG_Text : SVG_Shape {
     double x;
     double y;
-    std::string text;
-    std::string color;
+    SVG_String text;
+    SVG_String color;
 
-    SVG_Text(double x, double y, std::string text, std::string color = "")
-        : x(x), y(y), text(std::move(text)), color(std::move(color)) {}
+    SVG_Text(double x, double y, const std::string& text,
+             const std::string& color = "")
+        : x(x), y(y), text(svg_string(text)), color(svg_string(color)) {}
 
     std::ostream& print(std::ostream& a) const override {
-        a << "<text x=\"" << x << "\" y=\"" << y << '"';
+        a << "<text x=\"" << fmt_num(x) << "\" y=\"" << fmt_num(y) << '"';
         if (!color.empty())
             a << " fill=\"" << color << '"';
         return a << '>' << text << "</text>";
@@ -106,39 +203,46 @@ struct SVG_Text : SVG_Shape {
 };
 
 struct SVG_LinearGradient : SVG_Def {
-    std::string id;
+    SVG_String id;
     double x1;
     double y1;
     double x2;
     double y2;
-    std::list<std::pair<double, std::string>> stops;
+    tracked_list<std::pair<double, SVG_String>, MemTag::SVG> stops;
 
-    SVG_LinearGradient(std::string id, double x1, double y1, double x2,
+    SVG_LinearGradient(const std::string& id, double x1, double y1, double x2,
                        double y2,
-                       std::list<std::pair<double, std::string>> stops)
-        : id(std::move(id)), x1(x1), y1(y1), x2(x2), y2(y2),
-          stops(std::move(stops)) {}
-    SVG_LinearGradient(std::string id, double x1, double y1, double x2,
-                       double y2, std::string color1, std::string color2)
-        : id(std::move(id)), x1(x1), y1(y1), x2(x2), y2(y2),
-          stops({{0.0, std::move(color1)}, {100.0, std::move(color2)}}) {}
+                       const std::list<std::pair<double, std::string>>& stops)
+        : id(svg_string(id)), x1(x1), y1(y1), x2(x2), y2(y2) {
+        for (const std::pair<double, std::string>& stop : stops)
+            this->stops.emplace_back(stop.first, svg_string(stop.second));
+    }
+    SVG_LinearGradient(const std::string& id, double x1, double y1, double x2,
+                       double y2, const std::string& color1,
+                       const std::string& color2)
+        : id(svg_string(id)), x1(x1), y1(y1), x2(x2), y2(y2),
+          stops({{0.0, svg_string(color1)}, {100.0, svg_string(color2)}}) {}
 
     std::ostream& print(std::ostream& a) const override {
-        a << "<linearGradient id=\"" << id << "\" x1=\"" << x1 << "%\" y1=\""
-          << y1 << "%\" x2=\"" << x2 << "%\" y2=\"" << y2 << "%\">\n";
-        for (const std::pair<double, std::string>& stop : stops) {
-            a << "  <stop offset=\"" << stop.first << "%\" stop-color=\""
-              << stop.second << "\" />\n";
+        a << "<linearGradient id=\"" << id << "\" x1=\"" << fmt_num(x1)
+          << "%\" y1=\"" << fmt_num(y1) << "%\" x2=\"" << fmt_num(x2)
+          << "%\" y2=\"" << fmt_num(y2) << "%\">\n";
+        for (const std::pair<double, SVG_String>& stop : stops) {
+            a << "  <stop offset=\"" << fmt_num(stop.first)
+              << "%\" stop-color=\"" << stop.second << "\" />\n";
         }
         return a << "</linearGradient>";
     }
 };
 
 struct SVG {
+    typedef tracked_list<SVG_Def*, MemTag::SVG> DefList;
+    typedef tracked_list<SVG_Shape*, MemTag::SVG> ShapeList;
+
     size_t height;
     size_t width;
-    std::list<SVG_Def*> defs;
-    std::list<SVG_Shape*> shapes;
+    DefList defs;
+    ShapeList shapes;
 
     SVG(size_t height, size_t width) : height(height), width(width) {}
     ~SVG() {
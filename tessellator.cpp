@@ -1,30 +1,61 @@
+#include "checkpoint.h"
 #include "lib.h"
+#include "memory.h"
 #include "perlin.h"
 #include "svg.h"
 #include <algorithm>
+#include <chrono>
+#include <cctype>
+#include <cerrno>
 #include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <ctime>
 #include <list>
 #include <map>
+#include <memory>
+#include <set>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
 #include <vector>
 
 const long long HEIGHT = 1024 * 8;
 const long long WIDTH = 1024 * 8;
 const long long MIN_RADIUS = 16;
 const long long MAX_RADIUS = 64;
+// Number of frontier edges evaluated at once with --parallel
+const size_t FRONTIER_BATCH = 64;
+// Edges in a parallel batch are more than this many cells apart
+const size_t BATCH_SPACING = 2;
+// How many edges to look through per batch slot for well spaced ones
+const size_t BATCH_LOOKAHEAD = 4;
+// Default steps colors are rounded to, to group triangles with --paths
+const double PATH_HUE_STEP = 15;
+const double PATH_SHADE_STEP = 10;
+// Smaller steps are no use, and tiny ones would overflow the rounding
+const double PATH_MIN_STEP = 0.01;
+// Default seconds between checkpoints with --checkpoint
+const double CHECKPOINT_INTERVAL = 60;
+// Change whenever the checkpoint layout does
+const uint32_t CHECKPOINT_MAGIC = 0x53534554; // "TESS"
+const uint32_t CHECKPOINT_VERSION = 2;
 
 std::vector<SVG_Shape*> bonus_draw;
-std::list<SVG_Def*> _defs;
+SVG::DefList _defs;
 
 typedef std::pair<double, double> Coord;
 
-struct Point {
+struct Point : Tracked<MemTag::POINTS> {
     double x;
     double y;
     double radius;
-    std::map<Point*, unsigned char> links;
-    Point(double x, double y, double radius) : x(x), y(y), radius(radius) {}
-    Point(const Coord& loc, double radius)
-        : x(loc.first), y(loc.second), radius(radius) {}
+    size_t id; // Index in Space::all
+    tracked_map<Point*, unsigned char, MemTag::LINKS> links;
+    Point(double x, double y, double radius, size_t id = 0)
+        : x(x), y(y), radius(radius), id(id) {}
+    Point(const Coord& loc, double radius, size_t id = 0)
+        : x(loc.first), y(loc.second), radius(radius), id(id) {}
 
     friend void establish_links(Point* a, Point* b) {
         a->links.emplace(b, 0);
@@ -62,6 +93,12 @@ struct Point {
     }
 };
 
+typedef tracked_list<Point*, MemTag::GRID> PointList;
+typedef tracked_vector<Point*, MemTag::POINTS> PointVector;
+// Results of a neighbor query. These are short-lived and made on the hot path,
+// so they aren't counted.
+typedef std::list<Point*> NeighborList;
+
 std::pair<Coord, Coord> intersects(const Point* p1, const Point* p2,
                                    double add_radius = 0.0) {
     // https://math.stackexchange.com/a/1367732
@@ -81,6 +118,12 @@ std::pair<Coord, Coord> intersects(const Point* p1, const Point* p2,
     return {{base_x + b * dy, base_y + b * -dx},
             {base_x + b * -dy, base_y + b * dx}};
 }
+/* Whether `c` is a real location. intersects() gives NaN when the circles
+are too far apart to meet. */
+inline bool is_finite(const Coord& c) {
+    return std::isfinite(c.first) && std::isfinite(c.second);
+}
+
 struct ExposedEdge {
     Point* a;
     Point* b;
@@ -101,23 +144,300 @@ struct ExposedEdge {
             throw std::invalid_argument("first.b must equal second.a");
         return normalize_rad(second.angle() - first.angle() + M_PI);
     }
+
+    void save(BinaryWriter& out) const {
+        out.put<uint32_t>(a->id);
+        out.put<uint32_t>(b->id);
+        out.put(attempts);
+    }
+    static ExposedEdge load(BinaryReader& in, const PointVector& all) {
+        uint32_t a = in.get<uint32_t>();
+        uint32_t b = in.get<uint32_t>();
+        if (a >= all.size() || b >= all.size())
+            throw std::runtime_error("Checkpoint has an edge to no point");
+        ExposedEdge out(all[a], all[b]);
+        out.attempts = in.get<unsigned char>();
+        return out;
+    }
+};
+
+typedef tracked_list<ExposedEdge, MemTag::FRONTIER> EdgeList;
+
+inline void save_edges(BinaryWriter& out, const EdgeList& edges) {
+    out.put<uint32_t>(edges.size());
+    for (const ExposedEdge& edge : edges)
+        edge.save(out);
+}
+inline EdgeList load_edges(BinaryReader& in, const PointVector& all) {
+    EdgeList out;
+    for (uint32_t n = in.get<uint32_t>(); n > 0; --n)
+        out.push_back(ExposedEdge::load(in, all));
+    return out;
+}
+
+enum class FrontierPolicy {
+    FIFO,     // Try edges in the order they were added
+    PRIORITY, // Try edges facing the narrowest gaps first
+    ADAPTIVE, // FIFO, but shrink the new point to fit instead of retrying
+};
+
+inline const char* frontier_policy_name(FrontierPolicy policy) {
+    static const char* names[] = {"fifo", "priority", "adaptive"};
+    return names[(size_t)policy];
+}
+
+/* An edge waiting on a Frontier, and when it was added */
+struct QueuedEdge {
+    ExposedEdge edge;
+    size_t added;
+};
+typedef tracked_list<QueuedEdge, MemTag::FRONTIER> EdgeQueue;
+
+/**
+ * @brief Counts the copies of each edge waiting in a Frontier's queues.
+ * Removing an edge only marks its copies as removed, and they are dropped when
+ * they reach the front, so removal doesn't have to search the whole front.
+ */
+struct EdgeMarks {
+    struct State {
+        size_t queued;     // Copies still wanted
+        size_t stale;      // Removed copies that are still queued
+        size_t removed_at; // When the edge was last removed
+    };
+    tracked_unordered_map<unsigned long long, State, MemTag::FRONTIER> states;
+    size_t clock; // Goes up by one for every add and remove
+    size_t live;  // Copies of all edges still wanted
+
+    EdgeMarks() : clock(0), live(0) {}
+
+    static unsigned long long key(const ExposedEdge& edge) {
+        return (unsigned long long)edge.a->id << 32 | edge.b->id;
+    }
+
+    /* Counts a new copy of `edge`, which is then queued as the result */
+    QueuedEdge add(const ExposedEdge& edge) {
+        ++states[key(edge)].queued;
+        ++live;
+        return {edge, ++clock};
+    }
+    /* Marks every queued copy of `edge` as removed */
+    void remove(const ExposedEdge& edge) {
+        auto state = states.find(key(edge));
+        if (state == states.end() || state->second.queued == 0)
+            return;
+        live -= state->second.queued;
+        state->second.stale += state->second.queued;
+        state->second.queued = 0;
+        state->second.removed_at = ++clock;
+    }
+    bool wanted(const QueuedEdge& queued) const {
+        return queued.added > states.find(key(queued.edge))->second.removed_at;
+    }
+    /* Drops removed edges off the front of `queue`, returning whether there
+    is a wanted one left */
+    bool skip_removed(EdgeQueue& queue) {
+        while (!queue.empty() && !wanted(queue.front())) {
+            auto state = states.find(key(queue.front().edge));
+            if (--state->second.stale == 0 && state->second.queued == 0)
+                states.erase(state);
+            queue.pop_front();
+        }
+        return !queue.empty();
+    }
+    /* Takes the front of `queue`, which must be wanted */
+    ExposedEdge take_front(EdgeQueue& queue) {
+        ExposedEdge out = queue.front().edge;
+        queue.pop_front();
+        auto state = states.find(key(out));
+        if (--state->second.queued == 0 && state->second.stale == 0)
+            states.erase(state);
+        --live;
+        return out;
+    }
+
+    /* Writes the wanted edges of `queue` in the layout of save_edges() */
+    void save(BinaryWriter& out, const EdgeQueue& queue) const {
+        uint32_t count = 0;
+        for (const QueuedEdge& queued : queue)
+            count += wanted(queued);
+        out.put(count);
+        for (const QueuedEdge& queued : queue) {
+            if (wanted(queued))
+                queued.edge.save(out);
+        }
+    }
+    /* Reads edges written by save() onto the back of `queue` */
+    void load(BinaryReader& in, const PointVector& all, EdgeQueue& queue) {
+        for (const ExposedEdge& edge : load_edges(in, all))
+            queue.push_back(add(edge));
+    }
+};
+
+/* The ExposedEdges that are still waiting to be grown off of */
+struct Frontier {
+    virtual ~Frontier() = default;
+
+    virtual bool empty() const = 0;
+    virtual size_t size() const = 0;
+    /* Takes the next edge to try */
+    virtual ExposedEdge pop() = 0;
+    virtual void push(const ExposedEdge& edge) = 0;
+    /* Puts back an edge that was just popped, without it losing its place */
+    virtual void restore(const ExposedEdge& edge) = 0;
+    /* Removes all edges equal to `edge` */
+    virtual void remove(const ExposedEdge& edge) = 0;
+    /* Writes out the edges so that load() puts them back in the same order */
+    virtual void save(BinaryWriter& out) const = 0;
+    virtual void load(BinaryReader& in, const PointVector& all) = 0;
+};
+
+struct FifoFrontier : Frontier {
+    EdgeQueue edges;
+    EdgeMarks marks;
+
+    bool empty() const override { return marks.live == 0; }
+    size_t size() const override { return marks.live; }
+    ExposedEdge pop() override {
+        marks.skip_removed(edges);
+        return marks.take_front(edges);
+    }
+    void push(const ExposedEdge& edge) override {
+        edges.push_back(marks.add(edge));
+    }
+    void restore(const ExposedEdge& edge) override {
+        edges.push_front(marks.add(edge));
+    }
+    void remove(const ExposedEdge& edge) override { marks.remove(edge); }
+    void save(BinaryWriter& out) const override { marks.save(out, edges); }
+    void load(BinaryReader& in, const PointVector& all) override {
+        marks.load(in, all, edges);
+    }
 };
+
+struct PriorityFrontier : Frontier {
+    // Gaps narrower than this are closed before anything else is tried
+    static constexpr double NARROW_GAP = M_PI / 3;
+
+    // Each is in the order edges were added. Fully sorting by gap angle
+    // grows the front too unevenly and leaves huge dead edge loops.
+    EdgeQueue narrow;
+    EdgeQueue wide;
+    EdgeMarks marks; // Shared, since an edge can be in either
+
+    /* The smallest interior angle this edge makes with any other unfinished
+    link at either of its ends. Narrow gaps are cheap to close with an
+    existing point, and leaving them tends to produce dead edges. */
+    static double gap_angle(const ExposedEdge& edge) {
+        double out = 2 * M_PI;
+        for (const auto& link : edge.b->links) {
+            if (link.first != edge.a && link.second < 2)
+                out = std::min(out, interior_angle(
+                                        edge, ExposedEdge(edge.b, link.first)));
+        }
+        for (const auto& link : edge.a->links) {
+            if (link.first != edge.b && link.second < 2)
+                out = std::min(out, interior_angle(
+                                        ExposedEdge(link.first, edge.a), edge));
+        }
+        return out;
+    }
+
+    bool empty() const override { return marks.live == 0; }
+    size_t size() const override { return marks.live; }
+    ExposedEdge pop() override {
+        EdgeQueue& from = marks.skip_removed(narrow) ? narrow : wide;
+        marks.skip_removed(from);
+        return marks.take_front(from);
+    }
+    void push(const ExposedEdge& edge) override {
+        if (gap_angle(edge) < NARROW_GAP)
+            narrow.push_back(marks.add(edge));
+        else
+            wide.push_back(marks.add(edge));
+    }
+    void restore(const ExposedEdge& edge) override {
+        if (gap_angle(edge) < NARROW_GAP)
+            narrow.push_front(marks.add(edge));
+        else
+            wide.push_front(marks.add(edge));
+    }
+    void remove(const ExposedEdge& edge) override { marks.remove(edge); }
+    // Which list an edge went in depends on the links when it was added, so
+    // keep them as they are rather than pushing everything again
+    void save(BinaryWriter& out) const override {
+        marks.save(out, narrow);
+        marks.save(out, wide);
+    }
+    void load(BinaryReader& in, const PointVector& all) override {
+        marks.load(in, all, narrow);
+        marks.load(in, all, wide);
+    }
+};
+
+inline std::unique_ptr<Frontier> make_frontier(FrontierPolicy policy) {
+    if (policy == FrontierPolicy::PRIORITY)
+        return std::unique_ptr<Frontier>(new PriorityFrontier());
+    return std::unique_ptr<Frontier>(new FifoFrontier());
+}
+
+/* Counters for how much work growing the front took */
+struct GrowthStats {
+    size_t evaluations;    // Placements evaluated and committed
+    size_t overlaps;       // Placements that overlapped and were put back
+    size_t fitted;         // Overlaps fixed by shrinking the new point
+    size_t conflicts;      // Parallel placements invalidated by their batch
+    size_t dead_edges;     // Edges left for the loop filling
+    size_t grown;          // Triangles made while growing the front
+    size_t filled;         // Triangles made while filling loops
+    size_t max_frontier;   // Largest the front got
+    double grow_seconds;   // Spent growing the front, over all resumes
+    double fill_seconds;   // Spent filling loops
+
+    GrowthStats()
+        : evaluations(0), overlaps(0), fitted(0), conflicts(0), dead_edges(0),
+          grown(0), filled(0), max_frontier(0), grow_seconds(0),
+          fill_seconds(0) {}
+
+    friend std::ostream& operator<<(std::ostream& a, const GrowthStats& b) {
+        size_t triangles = b.grown + b.filled;
+        return a << "triangles: " << triangles << " (" << b.grown
+                 << " grown, " << b.filled << " filled)\n"
+                 << "evaluations: " << b.evaluations << " ("
+                 << (triangles ? (double)b.evaluations / triangles : 0)
+                 << " per triangle)\n"
+                 << "overlaps: " << b.overlaps << ", fitted: " << b.fitted
+                 << ", conflicts: " << b.conflicts << '\n'
+                 << "dead edges: " << b.dead_edges
+                 << ", max frontier: " << b.max_frontier << '\n'
+                 << "time: " << b.grow_seconds << "s growing, "
+                 << b.fill_seconds << "s filling loops";
+    }
+};
+
 struct Triangle {
     Point* a;
     Point* b;
     Point* c;
     Triangle(Point* a, Point* b, Point* c) : a(a), b(b), c(c) {}
 
-    SVG_Polygon to_poly() const {
+    static const ColorMap& color_map() {
         static ColorMap colorMap;
-        SVG_Polygon poly;
-        poly.points = {{a->x, a->y}, {b->x, b->y}, {c->x, c->y}};
-#ifdef SIMPLE_COLOR
+        return colorMap;
+    }
+    /* The flat color at the middle of the triangle */
+    HSL color() const {
         double mx = (a->x + b->x + c->x) / 3 / (MAX_RADIUS * 4);
         double my = (a->y + b->y + c->y) / 3 / (MAX_RADIUS * 4);
+        return color_map().hsl(mx, my);
+    }
 
-        poly.color = colorMap(mx, my);
+    SVG_Polygon to_poly() const {
+        SVG_Polygon poly;
+        poly.points = {{a->x, a->y}, {b->x, b->y}, {c->x, c->y}};
+#ifdef SIMPLE_COLOR
+        poly.color = svg_string(to_hsl(color()));
 #else
+        const ColorMap& colorMap = color_map();
         double mx = (a->x + b->x + c->x) / 3 / (MAX_RADIUS * 4);
         double my = (a->y + b->y + c->y) / 3 / (MAX_RADIUS * 4);
 
@@ -137,31 +457,93 @@ struct Triangle {
         std::string gradientID = "G" + std::to_string(gradient_num++);
         _defs.push_back(
             new SVG_LinearGradient(gradientID, 100, 0, 0, 100, color1, color2));
-        poly.color = "url(#" + gradientID + ')';
+        poly.color = svg_string("url(#" + gradientID + ')');
 #endif
         return poly;
     }
 };
+typedef tracked_vector<Triangle, MemTag::TRIANGLES> TriangleList;
+
+/* The result of trying to grow off of an ExposedEdge. Working this out only
+reads from the Space, so it can be done speculatively and committed later. */
+struct Placement {
+    enum Kind {
+        CLOSE_A,   // Make a triangle with `close`, already linked to edge.a
+        CLOSE_B,   // Make a triangle with `close`, already linked to edge.b
+        OVERLAP,   // A new point at `potential` would overlap something
+        NEW_POINT, // Add a new point at `potential`
+    } kind;
+    Coord potential;
+    double radius;
+    Point* close;
+    bool fitted; // The radius was shrunk to avoid an overlap
+};
 
 struct Space {
-    typedef std::list<ExposedEdge> Path;
-    typedef std::list<ExposedEdge> EdgeList;
-    typedef std::map<Point*, EdgeList> EdgeMap;
+    typedef EdgeList Path;
+    typedef tracked_vector<tracked_vector<PointList, MemTag::GRID>,
+                           MemTag::GRID>
+        Grid;
+    /* Orders points by when they were added, so loops are filled the same
+    way whatever addresses the points ended up at */
+    struct PointOrder {
+        bool operator()(const Point* a, const Point* b) const {
+            return a->id < b->id;
+        }
+    };
+    typedef tracked_map<Point*, EdgeList, MemTag::FRONTIER, PointOrder> EdgeMap;
+
+    /* An edge taken off the frontier as part of a parallel batch */
+    struct Speculation {
+        ExposedEdge edge;
+        double radius;
+        Placement placement;
+        bool cancelled; // The edge was removed by an earlier commit
+        bool conflict;  // An earlier commit changed the neighborhood
+
+        Speculation(const ExposedEdge& edge, double radius)
+            : edge(edge), radius(radius), placement(), cancelled(false),
+              conflict(false) {}
+    };
 
     double width;
     double height;
     size_t cell_width;
     size_t cell_height;
-    std::vector<Point*> all;
-    std::vector<std::vector<std::list<Point*>>> arr;
+    PointVector all;
+    Grid arr;
+    FrontierPolicy policy;
+    size_t batch_size; // Grow in parallel batches of this size if above 1
+    std::unique_ptr<Frontier> frontier;
+    EdgeList dead_edges;
+    TriangleList triangles;
+    bool grown; // Done growing the front, only loops are left to fill
+    GrowthStats stats;
+    // Only used while growing in parallel batches
+    tracked_vector<Speculation, MemTag::FRONTIER> pending;
+    // Last batch to change each cell
+    tracked_vector<tracked_vector<size_t, MemTag::GRID>, MemTag::GRID> touched;
+    // Last batch to take an edge near each cell
+    tracked_vector<tracked_vector<size_t, MemTag::GRID>, MemTag::GRID> claimed;
+    size_t batch;
+    // Where to save checkpoints while growing, if anywhere
+    std::string checkpoint_path;
+    double checkpoint_interval;
+    std::chrono::steady_clock::time_point last_checkpoint;
+    // Growth up to here has been added to stats.grow_seconds
+    std::chrono::steady_clock::time_point timed_until;
+    AsyncFileWriter checkpoint_writer;
 
-    Space(double width, double height)
+    Space(double width, double height,
+          FrontierPolicy policy = FrontierPolicy::FIFO)
         : width(width), height(height),
           cell_width((size_t)(width / MAX_RADIUS)),
           cell_height((size_t)(height / MAX_RADIUS)),
-          arr(cell_width, std::vector<std::list<Point*>>(cell_height,
-                                                         std::list<Point*>())) {
-    }
+          arr(cell_width,
+              tracked_vector<PointList, MemTag::GRID>(cell_height)),
+          policy(policy), batch_size(0), frontier(make_frontier(policy)),
+          grown(false), batch(0), checkpoint_interval(CHECKPOINT_INTERVAL),
+          timed_until(std::chrono::steady_clock::now()) {}
     inline size_t get_cell_x(double x) const {
         return cap_range<long long>(x / MAX_RADIUS, 0, cell_width - 1);
     }
@@ -169,9 +551,9 @@ struct Space {
         return cap_range<long long>(y / MAX_RADIUS, 0, cell_height - 1);
     }
 
-    std::list<Point*> get_neighbors(size_t cell_x, size_t cell_y,
-                                    size_t range = 1) {
-        std::list<Point*> out;
+    NeighborList get_neighbors(size_t cell_x, size_t cell_y,
+                               size_t range = 1) const {
+        NeighborList out;
         for (size_t x = std::max(cell_x, range) - range;
              x <= std::min(cell_x + range, cell_width - 1); ++x) {
             for (size_t y = std::max(cell_y, range) - range;
@@ -182,125 +564,440 @@ struct Space {
         }
         return out;
     }
-    inline std::list<Point*> get_neighbors(const Coord& c, size_t range = 1) {
+    inline NeighborList get_neighbors(const Coord& c, size_t range = 1) const {
         return get_neighbors(get_cell_x(c.first), get_cell_y(c.second), range);
     }
-    inline std::list<Point*> get_neighbors(const Point* p, size_t range = 1) {
+    inline NeighborList get_neighbors(const Point* p, size_t range = 1) const {
         return get_neighbors(get_cell_x(p->x), get_cell_y(p->y), range);
     }
 
     void add(double x, double y, double radius) {
-        all.push_back(new Point(x, y, radius));
+        all.push_back(new Point(x, y, radius, all.size()));
         arr[get_cell_x(x)][get_cell_y(y)].push_back(all.back());
     }
 
-    std::vector<Triangle> populate() {
-        std::vector<Triangle> out;
-        EdgeList edges;
-        EdgeList dead_edges;
-        // Add first point in middle
-        double first_radius = frandrange(MIN_RADIUS, MAX_RADIUS);
-        add(width / 2, height / 2, first_radius);
-        // Add second point around first point
-        double second_radius = frandrange(MIN_RADIUS, MAX_RADIUS);
-        double second_angle = frandrange(0, M_PI * 2);
-        add(width / 2 + (first_radius + second_radius) * cos(second_angle),
-            height / 2 + (first_radius + second_radius) * sin(second_angle),
-            second_radius);
-        // Set initial link/edges between first and second points
-        establish_links(all[0], all[1]);
-        edges.emplace_back(all[0], all[1]);
-        edges.emplace_back(all[1], all[0]);
-        // Go!
-        while (!edges.empty()) {
-            double new_radius = frandrange(MIN_RADIUS, MAX_RADIUS);
-            Coord potential =
-                intersects(edges.front().a, edges.front().b, new_radius).first;
-            // Now check if we can connect 3 in a triangle
-            for (Point* p : get_neighbors(potential)) {
-                if (p->dist2(potential) < pow(MIN_RADIUS, 2)) {
-                    // They are close
-                    for (auto link : edges.front().a->links) {
-                        if (link.second >= 2 || link.first != p)
-                            continue;
-                        // Epic! we can use this
-                        establish_links(p, edges.front().b);
-                        increment_links(p, edges.front().a, edges.front().b);
-                        out.emplace_back(p, edges.front().a, edges.front().b);
-
-                        if (in_range(width, height, p->x, p->y)) {
-                            // Remove the interior edges if applicable
-                            edges.remove(ExposedEdge(p, edges.front().a));
-                            edges.remove(ExposedEdge(edges.front().b, p));
-                            // Add a new edge
-                            edges.remove(ExposedEdge(p, edges.front().b));
-                            edges.emplace_back(p, edges.front().b);
-                        }
-                        goto endloop;
-                    }
-                    for (auto link : edges.front().b->links) {
-                        if (link.second >= 2 || link.first != p)
-                            continue;
-                        // Epic! we can use this
-                        establish_links(p, edges.front().a);
-                        increment_links(p, edges.front().a, edges.front().b);
-                        out.emplace_back(p, edges.front().a, edges.front().b);
-
-                        if (in_range(width, height, p->x, p->y)) {
-                            // Remove the interior edges
-                            edges.remove(ExposedEdge(p, edges.front().a));
-                            edges.remove(ExposedEdge(edges.front().b, p));
-                            // Add a new edge
-                            edges.remove(ExposedEdge(edges.front().a, p));
-                            edges.emplace_back(edges.front().a, p);
-                        }
-                        goto endloop;
-                    }
+    /* Marks the cell containing `p` as changed in the current batch */
+    inline void touch(const Point* p) {
+        if (!touched.empty())
+            touched[get_cell_x(p->x)][get_cell_y(p->y)] = batch;
+    }
+    bool was_touched(const Coord& c, size_t range) const {
+        size_t cell_x = get_cell_x(c.first);
+        size_t cell_y = get_cell_y(c.second);
+        for (size_t x = std::max(cell_x, range) - range;
+             x <= std::min(cell_x + range, cell_width - 1); ++x) {
+            for (size_t y = std::max(cell_y, range) - range;
+                 y <= std::min(cell_y + range, cell_height - 1); ++y) {
+                if (touched[x][y] == batch)
+                    return true;
+            }
+        }
+        return false;
+    }
+    /* Claims the cells around `edge` for the current batch, unless another
+    edge in the batch already has */
+    bool claim(const ExposedEdge& edge) {
+        size_t cell_x = get_cell_x((edge.a->x + edge.b->x) / 2);
+        size_t cell_y = get_cell_y((edge.a->y + edge.b->y) / 2);
+        if (claimed[cell_x][cell_y] == batch)
+            return false;
+        size_t range = BATCH_SPACING;
+        for (size_t x = std::max(cell_x, range) - range;
+             x <= std::min(cell_x + range, cell_width - 1); ++x) {
+            for (size_t y = std::max(cell_y, range) - range;
+                 y <= std::min(cell_y + range, cell_height - 1); ++y)
+                claimed[x][y] = batch;
+        }
+        return true;
+    }
+    void remove_edge(const ExposedEdge& edge) {
+        frontier->remove(edge);
+        for (Speculation& s : pending) {
+            if (s.edge == edge)
+                s.cancelled = true;
+        }
+    }
+
+    /* Whether a new point for `edge` with `radius` would overlap any of
+    `neighbors`, setting `potential` to where it would go. A point that
+    can't reach both ends of the edge counts as overlapping. */
+    static bool overlaps(const ExposedEdge& edge, double radius,
+                         const NeighborList& neighbors, Coord& potential) {
+        potential = intersects(edge.a, edge.b, radius).first;
+        if (!is_finite(potential))
+            return true;
+        for (const Point* p : neighbors) {
+            if (p->dist2(potential) < pow(p->radius + radius - 2, 2))
+                return true;
+        }
+        return false;
+    }
+
+    /* Works out what to do with `edge` if the new point has `new_radius`.
+    Does not modify anything, so it is safe to call from multiple threads. */
+    Placement evaluate(const ExposedEdge& edge, double new_radius) const {
+        Placement out{Placement::NEW_POINT,
+                      intersects(edge.a, edge.b, new_radius).first, new_radius,
+                      nullptr, false};
+        if (!is_finite(out.potential)) {
+            // Too small to reach both ends, so try again with another radius
+            out.kind = Placement::OVERLAP;
+            return out;
+        }
+        // Now check if we can connect 3 in a triangle
+        for (Point* p : get_neighbors(out.potential)) {
+            if (p->dist2(out.potential) < pow(MIN_RADIUS, 2)) {
+                // They are close
+                out.close = p;
+                auto link = edge.a->links.find(p);
+                if (link != edge.a->links.end() && link->second < 2) {
+                    out.kind = Placement::CLOSE_A;
+                    return out;
+                }
+                link = edge.b->links.find(p);
+                if (link != edge.b->links.end() && link->second < 2) {
+                    out.kind = Placement::CLOSE_B;
+                    return out;
                 }
+                out.close = nullptr;
             }
-            // Check if this overlaps with anything
-            for (const Point* p : get_neighbors(potential, 2)) {
-                if (p->dist2(potential) >= pow(p->radius + new_radius - 2, 2))
-                    continue;
-                // Here an overlap has been found
-                if (edges.front().attempts > 0) {
-                    // Put it for later
-                    edges.emplace_back(edges.front());
-                    --edges.back().attempts;
+        }
+        // Check if this overlaps with anything
+        for (const Point* p : get_neighbors(out.potential, 2)) {
+            if (p->dist2(out.potential) >= pow(p->radius + new_radius - 2, 2))
+                continue;
+            // Here an overlap has been found
+            out.kind = Placement::OVERLAP;
+            break;
+        }
+        if (out.kind == Placement::OVERLAP &&
+            policy == FrontierPolicy::ADAPTIVE) {
+            // Find the biggest radius that fits instead of rerolling later.
+            // The point moves as it shrinks, so look a bit further out.
+            NeighborList neighbors = get_neighbors(out.potential, 3);
+            Coord potential;
+            if (overlaps(edge, MIN_RADIUS, neighbors, potential))
+                return out;
+            out.kind = Placement::NEW_POINT;
+            out.fitted = true;
+            out.radius = MIN_RADIUS;
+            out.potential = potential;
+            double too_big = new_radius;
+            for (int i = 0; i < 6; ++i) {
+                double radius = (out.radius + too_big) / 2;
+                if (overlaps(edge, radius, neighbors, potential)) {
+                    too_big = radius;
                 } else {
-                    // Put it in dead edges to figure out later
-                    dead_edges.emplace_back(edges.front());
+                    out.radius = radius;
+                    out.potential = potential;
                 }
-                goto endloop;
             }
+        }
+        return out;
+    }
+
+    /* Applies the result of `evaluate` for an edge that has already been
+    taken off of the frontier */
+    void commit(const ExposedEdge& edge, const Placement& place) {
+        Point* p = place.close;
+        ++stats.evaluations;
+        if (place.fitted)
+            ++stats.fitted;
+        switch (place.kind) {
+        case Placement::CLOSE_A:
+            // Epic! we can use this
+            establish_links(p, edge.b);
+            increment_links(p, edge.a, edge.b);
+            triangles.emplace_back(p, edge.a, edge.b);
+            touch(p);
+            touch(edge.a);
+            touch(edge.b);
+            if (in_range(width, height, p->x, p->y)) {
+                // Remove the interior edges if applicable
+                remove_edge(ExposedEdge(p, edge.a));
+                remove_edge(ExposedEdge(edge.b, p));
+                // Add a new edge
+                remove_edge(ExposedEdge(p, edge.b));
+                frontier->push(ExposedEdge(p, edge.b));
+            }
+            break;
+        case Placement::CLOSE_B:
+            // Epic! we can use this
+            establish_links(p, edge.a);
+            increment_links(p, edge.a, edge.b);
+            triangles.emplace_back(p, edge.a, edge.b);
+            touch(p);
+            touch(edge.a);
+            touch(edge.b);
+            if (in_range(width, height, p->x, p->y)) {
+                // Remove the interior edges
+                remove_edge(ExposedEdge(p, edge.a));
+                remove_edge(ExposedEdge(edge.b, p));
+                // Add a new edge
+                remove_edge(ExposedEdge(edge.a, p));
+                frontier->push(ExposedEdge(edge.a, p));
+            }
+            break;
+        case Placement::OVERLAP:
+            ++stats.overlaps;
+            if (edge.attempts > 0) {
+                // Put it for later
+                ExposedEdge retry = edge;
+                --retry.attempts;
+                frontier->push(retry);
+            } else {
+                // Put it in dead edges to figure out later
+                dead_edges.emplace_back(edge);
+                ++stats.dead_edges;
+            }
+            break;
+        case Placement::NEW_POINT:
+            if (!is_finite(place.potential))
+                throw std::logic_error("New point has no location");
             // If not, keep going
-            add(potential.first, potential.second, new_radius);
-            establish_links(all.back(), edges.front().a);
-            establish_links(all.back(), edges.front().b);
-            increment_links(all.back(), edges.front().a, edges.front().b);
-            out.emplace_back(all.back(), edges.front().a, edges.front().b);
+            add(place.potential.first, place.potential.second, place.radius);
+            establish_links(all.back(), edge.a);
+            establish_links(all.back(), edge.b);
+            increment_links(all.back(), edge.a, edge.b);
+            triangles.emplace_back(all.back(), edge.a, edge.b);
+            touch(all.back());
+            touch(edge.a);
+            touch(edge.b);
             if (in_range(width, height, all.back()->x, all.back()->y)) {
-                edges.emplace_back(edges.front().a, all.back());
-                edges.emplace_back(all.back(), edges.front().b);
+                frontier->push(ExposedEdge(edge.a, all.back()));
+                frontier->push(ExposedEdge(all.back(), edge.b));
                 // Check if we can add any new edges
-                for (Point* p : get_neighbors(potential, 3)) {
+                for (Point* p : get_neighbors(place.potential, 3)) {
                     if (!in_range(width, height, p->x, p->y))
                         continue; // Don't make edges with points out of range
                     else if (p == all.back() || all.back()->links.count(p))
                         continue; // Only if there isn't already something
-                    else if (p->dist2(potential) <
-                             pow(p->radius + new_radius + MIN_RADIUS, 2)) {
+                    else if (p->dist2(place.potential) <
+                             pow(p->radius + place.radius + MIN_RADIUS, 2)) {
                         // These could have an edge
                         establish_links(p, all.back());
-                        edges.emplace_back(p, all.back());
-                        edges.emplace_back(all.back(), p);
+                        touch(p);
+                        frontier->push(ExposedEdge(p, all.back()));
+                        frontier->push(ExposedEdge(all.back(), p));
                     }
                 }
             }
+            break;
+        }
+        stats.max_frontier = std::max(stats.max_frontier, frontier->size());
+    }
+
+    /* Snapshots everything needed to carry on growing */
+    Snapshot save() const {
+        BinaryWriter out;
+        out.put(CHECKPOINT_MAGIC);
+        out.put(CHECKPOINT_VERSION);
+        out.put(width);
+        out.put(height);
+        out.put(policy);
+        out.put<uint64_t>(batch_size);
+        out.put(rng().state);
+        out.put(grown);
+        out.put(stats);
+        out.put<uint32_t>(all.size());
+        for (const Point* p : all) {
+            out.put(p->x);
+            out.put(p->y);
+            out.put(p->radius);
+        }
+        for (const Point* p : all) {
+            out.put<uint32_t>(p->links.size());
+            for (const auto& link : p->links) {
+                out.put<uint32_t>(link.first->id);
+                out.put(link.second);
+            }
+        }
+        frontier->save(out);
+        save_edges(out, dead_edges);
+        out.put<uint32_t>(triangles.size());
+        for (const Triangle& tri : triangles) {
+            out.put<uint32_t>(tri.a->id);
+            out.put<uint32_t>(tri.b->id);
+            out.put<uint32_t>(tri.c->id);
+        }
+        return std::move(out.data);
+    }
+    /* Picks up from a snapshot made by save(). Must be called on a new
+    Space of the same size. The random state is restored too. */
+    void load(BinaryReader& in) {
+        if (!all.empty())
+            throw std::logic_error("Can only load into an empty Space");
+        if (in.get<uint32_t>() != CHECKPOINT_MAGIC ||
+            in.get<uint32_t>() != CHECKPOINT_VERSION)
+            throw std::runtime_error("Not a checkpoint from this version");
+        if (in.get<double>() != width || in.get<double>() != height)
+            throw std::runtime_error("Checkpoint is for a different size");
+        typedef std::underlying_type<FrontierPolicy>::type PolicyValue;
+        PolicyValue policy_value = in.get<PolicyValue>();
+        if (policy_value < (PolicyValue)FrontierPolicy::FIFO ||
+            policy_value > (PolicyValue)FrontierPolicy::ADAPTIVE)
+            throw std::runtime_error("Checkpoint has an unknown frontier");
+        policy = (FrontierPolicy)policy_value;
+        frontier = make_frontier(policy);
+        batch_size = in.get<uint64_t>();
+        rng().state = in.get<unsigned long long>();
+        // Read as a byte, since any other value in a bool is undefined
+        unsigned char grown_value = in.get<unsigned char>();
+        if (grown_value > 1)
+            throw std::runtime_error("Checkpoint has a bad growth flag");
+        grown = grown_value;
+        stats = in.get<GrowthStats>();
+        uint32_t points = in.get<uint32_t>();
+        for (uint32_t i = 0; i < points; ++i) {
+            double x = in.get<double>();
+            double y = in.get<double>();
+            add(x, y, in.get<double>());
+        }
+        for (Point* p : all) {
+            for (uint32_t n = in.get<uint32_t>(); n > 0; --n) {
+                uint32_t id = in.get<uint32_t>();
+                if (id >= all.size())
+                    throw std::runtime_error("Checkpoint links to no point");
+                p->links.emplace(all[id], in.get<unsigned char>());
+            }
+        }
+        frontier->load(in, all);
+        dead_edges = load_edges(in, all);
+        for (uint32_t n = in.get<uint32_t>(); n > 0; --n) {
+            uint32_t a = in.get<uint32_t>();
+            uint32_t b = in.get<uint32_t>();
+            uint32_t c = in.get<uint32_t>();
+            if (a >= all.size() || b >= all.size() || c >= all.size())
+                throw std::runtime_error(
+                    "Checkpoint has a triangle of no point");
+            triangles.emplace_back(all[a], all[b], all[c]);
+        }
+    }
+    /* Saves a checkpoint in the background if one is due. Must only be
+    called between placements, when everything is consistent. */
+    void checkpoint(bool force = false) {
+        if (checkpoint_path.empty())
+            return;
+        std::chrono::steady_clock::time_point now =
+            std::chrono::steady_clock::now();
+        if (!force && std::chrono::duration<double>(now - last_checkpoint)
+                              .count() < checkpoint_interval)
+            return;
+        last_checkpoint = now;
+        if (!grown)
+            count_growth_time();
+        checkpoint_writer.write(checkpoint_path, save());
+    }
+
+    void count_growth_time() {
+        std::chrono::steady_clock::time_point now =
+            std::chrono::steady_clock::now();
+        stats.grow_seconds +=
+            std::chrono::duration<double>(now - timed_until).count();
+        timed_until = now;
+    }
+
+    void grow() {
+        while (!frontier->empty()) {
+            checkpoint();
+            ExposedEdge edge = frontier->pop();
+            double new_radius = frandrange(MIN_RADIUS, MAX_RADIUS);
+            commit(edge, evaluate(edge, new_radius));
+        }
+    }
+
+    /* Like grow(), but evaluates up to `batch_size` edges off the front at a
+    time in parallel. Edges close to one already in the batch are left for a
+    later one, since they would likely conflict. The batch is then committed
+    in order, and any whose neighborhood was changed by an earlier commit in
+    the batch is put back to be evaluated again. */
+    void grow_parallel(size_t batch_size) {
+        touched.assign(cell_width,
+                       tracked_vector<size_t, MemTag::GRID>(cell_height, 0));
+        claimed = touched;
+        EdgeList skipped;
+        WorkerPool pool;
+        while (!frontier->empty()) {
+            checkpoint();
+            ++batch;
+            pending.clear();
+            for (size_t looked = 0; !frontier->empty() &&
+                                    pending.size() < batch_size &&
+                                    looked < batch_size * BATCH_LOOKAHEAD;
+                 ++looked) {
+                ExposedEdge edge = frontier->pop();
+                if (claim(edge))
+                    pending.emplace_back(edge,
+                                         frandrange(MIN_RADIUS, MAX_RADIUS));
+                else
+                    skipped.push_front(edge);
+            }
+            // Put the skipped edges back where they were before committing,
+            // so they can be removed like any other
+            for (const ExposedEdge& edge : skipped)
+                frontier->restore(edge);
+            skipped.clear();
+            pool.run(pending.size(), [this](size_t i) {
+                pending[i].placement =
+                    evaluate(pending[i].edge, pending[i].radius);
+            });
+            for (Speculation& s : pending) {
+                if (s.cancelled)
+                    continue;
+                // Everything evaluate() reads is within 2 cells. Without a
+                // location it only depended on the edge itself.
+                if (is_finite(s.placement.potential) &&
+                    was_touched(s.placement.potential, 2)) {
+                    s.conflict = true;
+                    ++stats.conflicts;
+                } else
+                    commit(s.edge, s.placement);
+            }
+            // Retry conflicts first, without using up any attempts
+            for (auto s = pending.rbegin(); s != pending.rend(); ++s) {
+                if (s->conflict && !s->cancelled)
+                    frontier->restore(s->edge);
+            }
+        }
+        pending.clear();
+        touched.clear();
+        claimed.clear();
+    }
 
-        endloop:
-            edges.pop_front();
+    /* Triangulates the canvas, carrying on from where load() left off if it
+    was called. If `batch_size` is greater than 1, the front is grown with
+    grow_parallel() */
+    const TriangleList& populate() {
+        if (all.empty()) {
+            // Add first point in middle
+            double first_radius = frandrange(MIN_RADIUS, MAX_RADIUS);
+            add(width / 2, height / 2, first_radius);
+            // Add second point around first point
+            double second_radius = frandrange(MIN_RADIUS, MAX_RADIUS);
+            double second_angle = frandrange(0, M_PI * 2);
+            add(width / 2 + (first_radius + second_radius) * cos(second_angle),
+                height / 2 +
+                    (first_radius + second_radius) * sin(second_angle),
+                second_radius);
+            // Set initial link/edges between first and second points
+            establish_links(all[0], all[1]);
+            frontier->push(ExposedEdge(all[0], all[1]));
+            frontier->push(ExposedEdge(all[1], all[0]));
+        }
+        // Go!
+        if (!grown) {
+            last_checkpoint = timed_until = std::chrono::steady_clock::now();
+            if (batch_size > 1)
+                grow_parallel(batch_size);
+            else
+                grow();
+            count_growth_time();
+            stats.grown = triangles.size();
+            grown = true;
+            checkpoint(true);
         }
+        std::chrono::steady_clock::time_point fill_start =
+            std::chrono::steady_clock::now();
         // Now get the extra thingies
         // First, sort the edges by originating point
         EdgeMap edge_map;
@@ -310,10 +1007,10 @@ struct Space {
             dead_edges.pop_front();
         }
         // Then try to find loops and fill them
-        std::list<Path> loops;
+        tracked_list<Path, MemTag::FRONTIER> loops;
         for (auto& point : edge_map) {
             // Setup initial options
-            std::list<Path> paths;
+            tracked_list<Path, MemTag::FRONTIER> paths;
             for (const ExposedEdge& edge : point.second)
                 paths.push_back({edge});
             // Build paths
@@ -376,7 +1073,7 @@ struct Space {
                 y_sum += e->a->y;
                 SVG_Line* line =
                     new SVG_Line(e->a->x, e->a->y, e->b->x, e->b->y);
-                line->color = color;
+                line->color = svg_string(color);
                 line->width = 2;
                 bonus_draw.push_back(line);
             }
@@ -413,7 +1110,7 @@ struct Space {
                         "shouldn't happen.");
                 // Draw triangle
                 auto closest_next = loop_next(loop, closest);
-                out.emplace_back(closest->a, closest->b, closest_next->b);
+                triangles.emplace_back(closest->a, closest->b, closest_next->b);
                 establish_links(closest->a, closest_next->b);
                 increment_links(closest->a, closest->b, closest_next->b);
                 // Shrink loop
@@ -421,24 +1118,333 @@ struct Space {
                 loop.erase(closest);
                 loop.erase(closest_next);
             }
-            out.emplace_back(loop.front().a, loop.front().b, loop.back().a);
+            triangles.emplace_back(loop.front().a, loop.front().b,
+                                   loop.back().a);
             increment_links(loop.front().a, loop.front().b, loop.back().a);
         }
-        return out;
+        stats.filled = triangles.size() - stats.grown;
+        stats.fill_seconds = std::chrono::duration<double>(
+                                 std::chrono::steady_clock::now() - fill_start)
+                                 .count();
+        return triangles;
+    }
+};
+
+/* Roughly the peak resident memory of a run, worked out from the canvas size
+and radius range before starting. Counts and per-object sizes were measured
+on the default canvas, then checked against the peak RSS of real runs. */
+struct MemoryEstimate {
+    // Resident before anything is allocated: the program, the C++ runtime,
+    // and the stack
+    static constexpr double PROCESS = 3.5e6;
+    // What malloc's headers and rounding add on top of the bytes asked for.
+    // Generation is mostly 24 to 64 byte nodes, while polygons add a lot of
+    // short strings.
+    static constexpr double NODE_OVERHEAD = 1.1;
+    static constexpr double STRING_OVERHEAD = 1.3;
+
+    double points;
+    double triangles;
+    double generation; // Points, links, grid, frontier, and triangles
+    double polygons;   // What the default polygon output adds
+    double paths;      // What --paths output adds, including its grouping
+    double checkpoint; // Building a checkpoint snapshot, or loading one
+
+    MemoryEstimate(double width, double height) {
+        // Mean area of a point's circle, with radii uniform in the range.
+        // Points end up packed a bit tighter than their circles.
+        double circle = M_PI *
+                        (MIN_RADIUS * MIN_RADIUS + MIN_RADIUS * MAX_RADIUS +
+                         MAX_RADIUS * MAX_RADIUS) /
+                        3;
+        points = width * height / (circle * 0.76);
+        triangles = points * 2.07;
+        double cells = (width / MAX_RADIUS) * (height / MAX_RADIUS);
+        // Each point has about 6 links, each a 48 byte map node, and a
+        // 24 byte grid node. The point and triangle vectors can be double
+        // their size while growing, and edges and loops peak around 44 bytes
+        // a triangle.
+        generation =
+            NODE_OVERHEAD *
+            (points * (sizeof(Point) + 2 * sizeof(Point*) + 6 * 48 + 24) +
+             cells * sizeof(PointList) +
+             triangles * (2 * sizeof(Triangle) + 44));
+        // A polygon, its gradient, their list nodes, and color strings
+        polygons = STRING_OVERHEAD * triangles * 490;
+        // Path data, plus the sets and maps used to group triangles
+        paths = NODE_OVERHEAD * triangles * 110;
+        // The snapshot is about 27 bytes a triangle, and can briefly be held
+        // three times over while its string grows
+        checkpoint = triangles * 90;
+    }
+
+    /* The estimated peak resident bytes for a run with these options */
+    double total(bool with_paths, bool checkpointing) const {
+        return PROCESS + generation + (with_paths ? paths : polygons) +
+               (checkpointing ? checkpoint : 0);
     }
 };
 
-int main() {
-    srand(time(NULL));
+/* Draws the triangles with one path for each flat color, after rounding hue
+to `hue_step` degrees and saturation and light to `shade_step` percent.
+Triangles are drawn as fans around shared points where possible, so most start
+right where the last one closed. */
+SVG::ShapeList to_paths(const TriangleList& triangles,
+                        double hue_step = PATH_HUE_STEP,
+                        double shade_step = PATH_SHADE_STEP) {
+    typedef std::tuple<long, long, long> ColorKey;
+    const long hue_steps = std::max(std::lround(360 / hue_step), 1l);
+    typedef tracked_vector<const Triangle*, MemTag::SVG> Bucket;
+    tracked_map<ColorKey, Bucket, MemTag::SVG> buckets;
+    tracked_set<std::tuple<const Point*, const Point*, const Point*>,
+                MemTag::SVG>
+        drawn;
+    for (const Triangle& tri : triangles) {
+        // Skip triangles that are drawn twice, since they add nothing
+        const Point* v[3] = {tri.a, tri.b, tri.c};
+        std::sort(v, v + 3);
+        if (!drawn.emplace(v[0], v[1], v[2]).second)
+            continue;
+        HSL color = tri.color();
+        ColorKey key(
+            std::lround(fmod(fabs(color.hue), 360) / hue_step) % hue_steps,
+            std::lround(cap_range(color.saturation, 0.0, 100.0) / shade_step),
+            std::lround(cap_range(color.light, 0.0, 100.0) / shade_step));
+        buckets[key].push_back(&tri);
+    }
 
-    Space space(WIDTH, HEIGHT);
-    std::vector<Triangle> triangles = space.populate();
+    SVG::ShapeList out;
+    for (const auto& bucket : buckets) {
+        const Bucket& tris = bucket.second;
+        tracked_unordered_map<const Point*, tracked_vector<size_t, MemTag::SVG>,
+                              MemTag::SVG>
+            by_point;
+        for (size_t i = 0; i < tris.size(); ++i) {
+            by_point[tris[i]->a].push_back(i);
+            by_point[tris[i]->b].push_back(i);
+            by_point[tris[i]->c].push_back(i);
+        }
+        tracked_vector<bool, MemTag::SVG> done(tris.size(), false);
+        auto unused_at = [&](const Point* p) {
+            for (size_t i : by_point[p]) {
+                if (!done[i])
+                    return i;
+            }
+            return tris.size();
+        };
+
+        SVG_Path* path = new SVG_Path(
+            to_hsl(std::get<0>(bucket.first) * hue_step,
+                   std::get<1>(bucket.first) * shade_step,
+                   std::get<2>(bucket.first) * shade_step));
+        const Point* start = nullptr;
+        const Triangle* last = nullptr;
+        size_t next = 0;
+        for (size_t count = 0; count < tris.size(); ++count) {
+            size_t pick = start ? unused_at(start) : tris.size();
+            if (pick == tris.size()) {
+                // Prefer a point of the last triangle, since that's a short
+                // move
+                start = nullptr;
+                if (last) {
+                    for (const Point* p : {last->a, last->b, last->c}) {
+                        pick = unused_at(p);
+                        if (pick != tris.size()) {
+                            start = p;
+                            break;
+                        }
+                    }
+                }
+                if (!start) {
+                    while (done[next])
+                        ++next;
+                    pick = next;
+                    start = tris[pick]->a;
+                }
+                path->move_to(start->x, start->y);
+            }
+            done[pick] = true;
+            last = tris[pick];
+            // Go around from start, always the same way round so any overlaps
+            // don't cancel out with the nonzero fill rule
+            const Point* v[3] = {last->a, last->b, last->c};
+            std::rotate(v, std::find(v, v + 3, start), v + 3);
+            if ((v[1]->x - v[0]->x) * (v[2]->y - v[0]->y) -
+                    (v[2]->x - v[0]->x) * (v[1]->y - v[0]->y) <
+                0)
+                std::swap(v[1], v[2]);
+            path->line_to(v[1]->x, v[1]->y);
+            path->line_to(v[2]->x, v[2]->y);
+            path->close();
+        }
+        out.push_back(path);
+    }
+    return out;
+}
+
+/* Parses all of `text` as a whole number, returning whether it was one */
+bool parse_arg(const std::string& text, unsigned long long& out) {
+    if (text.empty() || !isdigit((unsigned char)text[0]))
+        return false; // strtoull would take a sign or spaces
+    char* end;
+    errno = 0;
+    out = std::strtoull(text.c_str(), &end, 10);
+    return *end == '\0' && errno == 0;
+}
+/* Parses all of `text` as a finite number that isn't negative */
+bool parse_arg(const std::string& text, double& out) {
+    if (text.empty() || isspace((unsigned char)text[0]))
+        return false;
+    char* end;
+    errno = 0;
+    out = std::strtod(text.c_str(), &end);
+    return *end == '\0' && errno == 0 && std::isfinite(out) && out >= 0;
+}
+
+int main(int argc, char* argv[]) {
+    size_t batch_size = 0;
+    FrontierPolicy policy = FrontierPolicy::FIFO;
+    bool print_stats = false;
+    bool paths = false;
+    unsigned long long seed = time(NULL);
+    std::string checkpoint_path;
+    double checkpoint_interval = CHECKPOINT_INTERVAL;
+    bool resume = false;
+    double memory_budget = 0; // In MB, or 0 for no limit
+    double hue_step = PATH_HUE_STEP;
+    double shade_step = PATH_SHADE_STEP;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool valid = true;
+        unsigned long long count = 0;
+        if (arg == "--parallel")
+            batch_size = FRONTIER_BATCH;
+        else if (arg.compare(0, 11, "--parallel=") == 0) {
+            valid = parse_arg(arg.substr(11), count);
+            batch_size = count;
+        } else if (arg == "--frontier=fifo")
+            policy = FrontierPolicy::FIFO;
+        else if (arg == "--frontier=priority")
+            policy = FrontierPolicy::PRIORITY;
+        else if (arg == "--frontier=adaptive")
+            policy = FrontierPolicy::ADAPTIVE;
+        else if (arg == "--stats")
+            print_stats = true;
+        else if (arg == "--paths")
+            paths = true;
+        else if (arg.compare(0, 11, "--hue-step=") == 0)
+            valid = parse_arg(arg.substr(11), hue_step) &&
+                    hue_step >= PATH_MIN_STEP && hue_step <= 360;
+        else if (arg.compare(0, 13, "--shade-step=") == 0)
+            valid = parse_arg(arg.substr(13), shade_step) &&
+                    shade_step >= PATH_MIN_STEP && shade_step <= 100;
+        else if (arg.compare(0, 12, "--precision=") == 0) {
+            valid = parse_arg(arg.substr(12), count);
+            svg_precision() = std::min(count, 9ull);
+        } else if (arg.compare(0, 7, "--seed=") == 0)
+            valid = parse_arg(arg.substr(7), seed);
+        else if (arg.compare(0, 13, "--checkpoint=") == 0)
+            checkpoint_path = arg.substr(13);
+        else if (arg.compare(0, 22, "--checkpoint-interval=") == 0)
+            valid = parse_arg(arg.substr(22), checkpoint_interval);
+        else if (arg == "--resume")
+            resume = true;
+        else if (arg.compare(0, 16, "--memory-budget=") == 0)
+            valid = parse_arg(arg.substr(16), memory_budget);
+        else if (arg.compare(0, 10, "--palette=") == 0) {
+            std::string name = arg.substr(10);
+            palette_choice() = find_palette(name);
+            if (!palette_choice()) {
+                std::cerr << "Unknown palette: " << name << std::endl;
+                return 1;
+            }
+        } else {
+            std::cerr << "Unknown argument: " << arg << std::endl;
+            return 1;
+        }
+        if (!valid) {
+            std::cerr << "Invalid value: " << arg << std::endl;
+            return 1;
+        }
+    }
+    if (resume && checkpoint_path.empty()) {
+        std::cerr << "--resume needs --checkpoint" << std::endl;
+        return 1;
+    }
+    if (memory_budget > 0) {
+        MemoryEstimate estimate(WIDTH, HEIGHT);
+        bool checkpointing = !checkpoint_path.empty();
+        double with_polygons = estimate.total(false, checkpointing) / 1e6;
+        double with_paths = estimate.total(true, checkpointing) / 1e6;
+        if (with_paths > memory_budget) {
+            std::cerr << "Needs about " << with_paths
+                      << " MB even with --paths, over the budget of "
+                      << memory_budget << " MB" << std::endl;
+            return 1;
+        } else if (!paths && with_polygons > memory_budget) {
+            std::cerr << "Needs about " << with_polygons
+                      << " MB with polygons, using --paths to fit in "
+                      << memory_budget << " MB" << std::endl;
+            paths = true;
+        }
+    }
+    // Before anything tracked is allocated
+    mem_tracking() = print_stats;
+    rng() = Random(seed);
+
+    Space space(WIDTH, HEIGHT, policy);
+    space.batch_size = batch_size;
+    space.checkpoint_path = checkpoint_path;
+    space.checkpoint_interval = checkpoint_interval;
+    if (resume && std::ifstream(checkpoint_path)) {
+        try {
+            BinaryReader in = BinaryReader::from_file(checkpoint_path);
+            space.load(in);
+            // Carrying on any other way wouldn't match an uninterrupted run
+            if (space.policy != policy)
+                std::cerr << "Using --frontier="
+                          << frontier_policy_name(space.policy)
+                          << " from the checkpoint instead of "
+                          << frontier_policy_name(policy) << std::endl;
+            if (std::max<size_t>(space.batch_size, 1) !=
+                std::max<size_t>(batch_size, 1)) {
+                auto describe = [](size_t batch_size) {
+                    return batch_size > 1
+                               ? "--parallel=" + std::to_string(batch_size)
+                               : std::string("no --parallel");
+                };
+                std::cerr << "Using " << describe(space.batch_size)
+                          << " from the checkpoint instead of "
+                          << describe(batch_size) << std::endl;
+            }
+        } catch (const std::runtime_error& e) {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+    } else if (resume) {
+        std::cerr << "No checkpoint yet, starting from scratch" << std::endl;
+    }
+    if (!checkpoint_path.empty()) {
+        // Save one right away, so a path that can't be written to is caught
+        // before any work is done
+        space.checkpoint(true);
+        if (!space.checkpoint_writer.wait())
+            return 1;
+    }
+    const TriangleList& triangles = space.populate();
+    space.checkpoint_writer.wait();
+    if (print_stats)
+        std::cerr << space.stats << std::endl;
 
     // Draw triangles
     SVG svg(HEIGHT, WIDTH);
-    for (const Triangle& tri : triangles)
-        svg.shapes.push_back(new SVG_Polygon(tri.to_poly()));
-    svg.defs = _defs;
+    if (paths) {
+        svg.shapes = to_paths(triangles, hue_step, shade_step);
+    } else {
+        for (const Triangle& tri : triangles)
+            svg.shapes.push_back(new SVG_Polygon(tri.to_poly()));
+        svg.defs = _defs;
+    }
 
 #ifdef DEBUG
     // Overlay circles
@@ -452,4 +1458,7 @@ int main() {
     std::ofstream file("out.svg");
     file << "<!DOCTYPE svg>\n" << svg << std::endl;
     file.close();
+    if (print_stats)
+        print_mem_stats(std::cerr) << std::endl;
+    return space.checkpoint_writer.failures ? 1 : 0;
 }
\ No newline at end of file